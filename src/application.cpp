@@ -21,6 +21,14 @@ struct TrialResult {
     double loss_rate;
     uint32_t final_cwnd;
     uint32_t final_ssthresh;
+    uint32_t final_rcv_buf;
+    size_t window_probes;
+    size_t rto_timeouts;
+    size_t tail_loss_probes;
+    // Share of completion time the sender spent limited by each factor
+    double network_limited_pct;
+    double cwnd_limited_pct;
+    double rwnd_limited_pct;
 };
 
 // Structure to hold statistics across trials
@@ -38,11 +46,18 @@ struct ScenarioStats {
     double mean_utilization = 0;
     double mean_retransmits = 0;
     double mean_loss_rate = 0;
+    double mean_rto_timeouts = 0;
+    double mean_tail_loss_probes = 0;
+
+    double mean_network_limited = 0;
+    double mean_cwnd_limited = 0;
+    double mean_rwnd_limited = 0;
 
     void compute(const std::vector<TrialResult>& trials) {
         if (trials.empty()) return;
 
         double sum_time = 0, sum_throughput = 0, sum_util = 0, sum_retrans = 0, sum_loss = 0;
+        double sum_net = 0, sum_cwnd = 0, sum_rwnd = 0, sum_rtos = 0, sum_tlps = 0;
 
         for (const auto& t : trials) {
             sum_time += t.completion_time;
@@ -50,6 +65,11 @@ struct ScenarioStats {
             sum_util += t.link_utilization;
             sum_retrans += t.retransmits;
             sum_loss += t.loss_rate;
+            sum_rtos += t.rto_timeouts;
+            sum_tlps += t.tail_loss_probes;
+            sum_net += t.network_limited_pct;
+            sum_cwnd += t.cwnd_limited_pct;
+            sum_rwnd += t.rwnd_limited_pct;
 
             min_time = std::min(min_time, t.completion_time);
             max_time = std::max(max_time, t.completion_time);
@@ -63,6 +83,11 @@ struct ScenarioStats {
         mean_utilization = sum_util / n;
         mean_retransmits = sum_retrans / n;
         mean_loss_rate = sum_loss / n;
+        mean_rto_timeouts = sum_rtos / n;
+        mean_tail_loss_probes = sum_tlps / n;
+        mean_network_limited = sum_net / n;
+        mean_cwnd_limited = sum_cwnd / n;
+        mean_rwnd_limited = sum_rwnd / n;
 
         // Compute standard deviations
         double var_time = 0, var_throughput = 0;
@@ -75,7 +100,9 @@ struct ScenarioStats {
     }
 };
 
-TrialResult run_simulation(const char* scenario_name, Link L, size_t bytes_to_send, Time end_check_interval, bool verbose)
+TrialResult run_simulation(const char* scenario_name, Link L, size_t bytes_to_send, const RecvApp& reader,
+                           const SendConfig& sender,
+                           Time end_check_interval, bool verbose)
 {
     ZoneScoped;
     ZoneName(scenario_name, strlen(scenario_name));
@@ -94,7 +121,7 @@ TrialResult run_simulation(const char* scenario_name, Link L, size_t bytes_to_se
     sim.now = 0.0;
     while (!sim.pq.empty()) sim.pq.pop();
 
-    TCPConnection c(L, bytes_to_send);
+    TCPConnection c(L, bytes_to_send, reader, sender);
 
     // Plot link parameters
     TracyPlot("TCP_LinkBandwidth_Mbps", L.bandwidth_bps / 1e6);
@@ -150,15 +177,25 @@ TrialResult run_simulation(const char* scenario_name, Link L, size_t bytes_to_se
 
         if (done || sim.now > 300.0) {
             TracyMessageC("Simulation Complete", 20, 0x00FF00);
+            // Stop here; stale timers and reader ticks would otherwise run the clock on
+            while (!sim.pq.empty()) sim.pq.pop();
+            if (!done) c.A.note_limit(c.A.limit);
+            Time finished = done ? c.A.fin_acked_at : sim.now;
             if (verbose) {
+                const Time* lim = c.A.limited_s;
                 cout << fixed << setprecision(3);
-                cout << "Simulation finished at t=" << sim.now << " s\n";
+                cout << "Simulation finished at t=" << finished << " s\n";
                 cout << "Data sent: " << (bytes_to_send / 1024.0) << " KiB, retransmits=" << c.A.retransmits << "\n";
                 cout << "Packets: sent=" << c.total_packets_sent << ", dropped=" << c.total_packets_dropped
                      << " (" << ((double)c.total_packets_dropped / c.total_packets_sent * 100.0) << "%)\n";
-                cout << "Final cwnd=" << c.A.cwnd << " ssthresh=" << c.A.ssthresh << " RTO=" << c.A.rto << "s\n";
-                cout << "Average throughput: " << (bytes_to_send * 8.0 / sim.now / 1e6) << " Mbps\n";
-                cout << "Link utilization: " << (bytes_to_send * 8.0 / sim.now / L.bandwidth_bps * 100.0) << "%\n";
+                cout << "Final cwnd=" << c.A.cwnd << " ssthresh=" << c.A.ssthresh << " RTO=" << c.A.rto << "s"
+                     << " SRTT=" << (c.A.srtt * 1000.0) << "ms\n";
+                cout << "RTO timeouts=" << c.A.rto_timeouts << ", tail loss probes=" << c.A.tail_loss_probes << "\n";
+                cout << "Receive buffer=" << (c.B.rcv_buf / 1024.0) << " KiB, zero-window probes=" << c.A.window_probes << "\n";
+                cout << "Limited by: network " << lim[L_NETWORK] << "s, cwnd " << lim[L_CWND]
+                     << "s, receiver " << lim[L_RWND] << "s\n";
+                cout << "Average throughput: " << (bytes_to_send * 8.0 / finished / 1e6) << " Mbps\n";
+                cout << "Link utilization: " << (bytes_to_send * 8.0 / finished / L.bandwidth_bps * 100.0) << "%\n";
             }
         } else {
             sim.at(sim.now + end_check_interval, periodic);
@@ -169,22 +206,31 @@ TrialResult run_simulation(const char* scenario_name, Link L, size_t bytes_to_se
     sim.run();
 
     // Return results
+    Time finished = c.A.fin_acked ? c.A.fin_acked_at : sim.now;
     TrialResult result;
-    result.completion_time = sim.now;
-    result.avg_throughput_mbps = (bytes_to_send * 8.0 / sim.now) / 1e6;
-    result.link_utilization = (bytes_to_send * 8.0 / sim.now / L.bandwidth_bps) * 100.0;
+    result.completion_time = finished;
+    result.avg_throughput_mbps = (bytes_to_send * 8.0 / finished) / 1e6;
+    result.link_utilization = (bytes_to_send * 8.0 / finished / L.bandwidth_bps) * 100.0;
     result.retransmits = c.A.retransmits;
     result.packets_sent = c.total_packets_sent;
     result.packets_dropped = c.total_packets_dropped;
     result.loss_rate = c.total_packets_sent > 0 ? ((double)c.total_packets_dropped / c.total_packets_sent * 100.0) : 0.0;
     result.final_cwnd = c.A.cwnd;
     result.final_ssthresh = c.A.ssthresh;
+    result.final_rcv_buf = c.B.rcv_buf;
+    result.window_probes = c.A.window_probes;
+    result.rto_timeouts = c.A.rto_timeouts;
+    result.tail_loss_probes = c.A.tail_loss_probes;
+    result.network_limited_pct = c.A.limited_s[L_NETWORK] / finished * 100.0;
+    result.cwnd_limited_pct = c.A.limited_s[L_CWND] / finished * 100.0;
+    result.rwnd_limited_pct = c.A.limited_s[L_RWND] / finished * 100.0;
 
     return result;
 }
 
 // Run multiple trials and compute statistics
-void run_scenario_trials(const char* scenario_name, Link L, size_t bytes_to_send, size_t num_trials = 20)
+void run_scenario_trials(const char* scenario_name, Link L, size_t bytes_to_send, size_t num_trials = 20,
+                         const RecvApp& reader = {}, const SendConfig& sender = {})
 {
     ZoneScoped;
     cout << "\n========================================\n";
@@ -204,7 +250,7 @@ void run_scenario_trials(const char* scenario_name, Link L, size_t bytes_to_send
         cout << "  Trial " << (i + 1) << "/" << num_trials << "... " << flush;
 
         // Only verbose output for first trial
-        TrialResult result = run_simulation(scenario_name, L, bytes_to_send, 0.05, i == 0);
+        TrialResult result = run_simulation(scenario_name, L, bytes_to_send, reader, sender, 0.05, i == 0);
         trials.push_back(result);
 
         if (i > 0) {  // Skip first trial since it already printed
@@ -231,12 +277,19 @@ void run_scenario_trials(const char* scenario_name, Link L, size_t bytes_to_send
     cout << "\nLoss & Retransmissions:\n";
     cout << "  Mean Packet Loss:  " << stats.mean_loss_rate << " %\n";
     cout << "  Mean Retransmits:  " << stats.mean_retransmits << "\n";
+    cout << "  Mean RTO Timeouts: " << stats.mean_rto_timeouts << "\n";
+    cout << "  Mean Tail Probes:  " << stats.mean_tail_loss_probes << "\n";
+    cout << "\nLimited By (share of completion time):\n";
+    cout << "  Network:  " << stats.mean_network_limited << " %\n";
+    cout << "  Cwnd:     " << stats.mean_cwnd_limited << " %\n";
+    cout << "  Receiver: " << stats.mean_rwnd_limited << " %\n";
     cout << "========================================\n";
 
     // Tracy plot for aggregate stats
     TracyPlot("Scenario_MeanThroughput_Mbps", stats.mean_throughput);
     TracyPlot("Scenario_MeanTime_s", stats.mean_time);
     TracyPlot("Scenario_MeanUtilization_percent", stats.mean_utilization);
+    TracyPlot("Scenario_ReceiverLimited_percent", stats.mean_rwnd_limited);
 }
 
 // TIP To <b>Run</b> code, press <shortcut actionId="Run"/> or click the <icon src="AllIcons.Actions.Execute"/> icon in the gutter.
@@ -294,9 +347,30 @@ int main()
                         3 * 1024 * 1024,  // 3 MiB
                         TRIALS);
 
+    // Scenario 7: clean link, but the receiving app only drains 1 Mbps
+    RecvApp slow_reader;
+    slow_reader.mode = R_FIXED_RATE;
+    slow_reader.rate_bps = 1e6;
+    run_scenario_trials("S7: Slow Consumer (10Mbps, 50ms, 0.1% loss, app reads 1Mbps)",
+                        Link{10e6, 0.050, 0.001},
+                        2 * 1024 * 1024,  // 2 MiB
+                        TRIALS, slow_reader);
+
+    // Scenario 8: S1's link, small fixed buffer emptied in bursts
+    RecvApp bursty_reader;
+    bursty_reader.mode = R_BURSTY;
+    bursty_reader.burst_bytes = 256 * 1024;
+    bursty_reader.period = 0.050;
+    bursty_reader.rcv_buf = 128 * 1024;
+    bursty_reader.autotune = false;
+    run_scenario_trials("S8: Bursty Reader (100Mbps, 10ms, 0.1% loss, 128KiB buffer)",
+                        Link{100e6, 0.010, 0.001},
+                        5 * 1024 * 1024,  // 5 MiB
+                        TRIALS, bursty_reader);
+
     cout << "\n========================================\n";
     cout << "All scenarios complete!\n";
-    cout << "Total trials run: " << (TRIALS * 6) << " (" << TRIALS << " per scenario)\n";
+    cout << "Total trials run: " << (TRIALS * 8) << " (" << TRIALS << " per scenario)\n";
     cout << "Check Tracy Profiler for detailed graphs\n";
     cout << "========================================\n";
 
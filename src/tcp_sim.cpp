@@ -3,6 +3,8 @@
 //
 #include "tcp_sim.h"
 #include <tracy/Tracy.hpp>
+#include <algorithm>
+#include <cmath>
 
 void Simulator::run()
 {
@@ -31,9 +33,45 @@ bool Link::lost() const
     return U(rng) < loss_prob;
 }
 
+void RangeSet::add(uint32_t start, uint32_t end)
+{
+    if (start >= end) return;
+    // First range that could touch [start, end)
+    auto it = lower_bound(ranges.begin(), ranges.end(), start,
+                          [](const SeqRange &r, uint32_t s) { return r.end < s; });
+    auto last = it;
+    while (last != ranges.end() && last->start <= end)
+    {
+        start = min(start, last->start);
+        end = max(end, last->end);
+        ++last;
+    }
+    it = ranges.erase(it, last);
+    ranges.insert(it, SeqRange{start, end});
+}
+
+void RangeSet::trim_below(uint32_t seq)
+{
+    auto it = ranges.begin();
+    while (it != ranges.end() && it->end <= seq) ++it;
+    it = ranges.erase(ranges.begin(), it);
+    if (it != ranges.end() && it->start < seq) it->start = seq;
+}
+
+const SeqRange *RangeSet::find(uint32_t seq) const
+{
+    for (const auto &r : ranges)
+    {
+        if (seq < r.start) break;
+        if (seq < r.end) return &r;
+    }
+    return nullptr;
+}
+
 void Endpoint::start_client()
 {
     // Send SYN
+    syn_sent_at = sim.now;
     send_segment(iss, 0, F_SYN);
     snd_nxt = iss + 1; // SYN consumes one sequence
     arm_timer();
@@ -45,15 +83,22 @@ void Endpoint::on_segment(const Segment &seg)
     ZoneText(name.c_str(), name.size());
 
     // Basic receiver behavior
-    if (has(seg.flags, F_SYN))
+    if (has(seg.flags, F_SYN) && !has(seg.flags, F_ACK))
     {
         // Passive open: reply SYN-ACK
         rcv_nxt = seg.seq + 1;
+        rcv_read = rcv_nxt;
+        rcv_rtt_seq = rcv_nxt + rcv_wnd();
+        rcv_rtt_time = sim.now;
+        rcv_space = min(rcv_buf, 10 * mss);
+        rcv_space_seq = rcv_read;
+        rcv_space_time = sim.now;
         Segment out;
         out.flags = (Flags) (F_SYN | F_ACK);
         out.seq = 5000; // B's ISN
         out.ack = rcv_nxt;
         out.len = 0;
+        out.wnd = rcv_adv = rcv_wnd();
         conn->deliver(*this, *(this == &(conn->A) ? &(conn->B) : &(conn->A)), out);
         return;
     }
@@ -65,6 +110,10 @@ void Endpoint::on_segment(const Segment &seg)
         {
             // A received SYN-ACK → send final ACK
             rcv_nxt = seg.seq + 1;
+            snd_una = seg.ack; // our SYN is acknowledged
+            rwnd = seg.wnd;
+            cancel_timer();
+            if (!syn_retransmitted) rtt_sample(sim.now - syn_sent_at);
             Segment finAck;
             finAck.flags = F_ACK;
             finAck.seq = snd_nxt;
@@ -83,25 +132,84 @@ void Endpoint::on_segment(const Segment &seg)
     // Data processing at receiver (B)
     if (name == "B")
     {
-        if (seg.seq == rcv_nxt)
+        bool fin = has(seg.flags, F_FIN);
+        uint32_t end = seg.seq + seg.len + (fin ? 1 : 0);
+        // Data past the buffer's right edge has nowhere to go; the FIN takes no space
+        bool fits = seg.seq + seg.len <= rcv_read + rcv_buf;
+        if (end > rcv_nxt && fits)
         {
-            rcv_nxt += seg.len;
-            if (has(seg.flags, F_FIN)) rcv_nxt += 1;
+            if (fin) rcv_fin = end;
+            if (seg.seq <= rcv_nxt)
+            {
+                // In order: advance, then pull in anything this filled the hole for
+                rcv_nxt = end;
+                if (!ooo.empty() && ooo.ranges.front().start <= rcv_nxt)
+                    rcv_nxt = max(rcv_nxt, ooo.ranges.front().end);
+                ooo.trim_below(rcv_nxt);
+
+                // A window's worth arrived: that took at most one RTT
+                if (rcv_nxt >= rcv_rtt_seq)
+                {
+                    Time sample = sim.now - rcv_rtt_time;
+                    rcv_rtt = rcv_rtt > 0.0 ? min(rcv_rtt, sample) : sample;
+                    rcv_rtt_seq = rcv_nxt + max(rcv_wnd(), 4 * mss);
+                    rcv_rtt_time = sim.now;
+                }
+            } else
+            {
+                // Out of order: hold it and report it via SACK
+                ooo.add(seg.seq, end);
+                last_ooo_seq = seg.seq;
+            }
         }
-        // Always ACK cumulatively
-        Segment ack;
-        ack.flags = F_ACK;
-        ack.seq = 5000;
-        ack.ack = rcv_nxt;
-        ack.len = 0;
-        conn->deliver(*this, conn->A, ack);
+        if (reader.mode == R_INSTANT) app_read(SIZE_MAX);
+        // Always ACK cumulatively, plus SACK blocks for what we hold beyond
+        send_ack();
         return;
     }
 
     // ACK handling at sender (A)
     if (name == "A" && has(seg.flags, F_ACK))
     {
-        if (seg.ack > snd_una)
+        uint32_t old_rwnd = rwnd;
+        rwnd = seg.wnd;
+        TracyPlot("TCP_RWND", (int64_t) rwnd);
+
+        // Walk what this ACK delivers: cumulatively ACKed segments leave the queue,
+        // newly SACKed ones are marked. Both feed RACK and the RTT estimator.
+        Time rtt_sent = -1.0; // send time of the newest unambiguous delivery
+        uint32_t sacked_before = sacked_bytes;
+        while (!rtx_queue.empty() && rtx_queue.front().end <= seg.ack)
+        {
+            TxSegment &s = rtx_queue.front();
+            // A SACKed segment was delivered by an earlier ACK; its timing is stale now
+            if (!s.sacked) on_delivered(s, rtt_sent);
+            else sacked_bytes -= s.end - s.seq;
+            if (s.lost) lost_bytes -= s.end - s.seq;
+            rtx_queue.pop_front();
+        }
+        for (int i = 0; i < seg.sack_count; i++)
+        {
+            auto it = lower_bound(rtx_queue.begin(), rtx_queue.end(), seg.sack[i].start,
+                                  [](const TxSegment &s, uint32_t seq) { return s.seq < seq; });
+            for (; it != rtx_queue.end() && it->end <= seg.sack[i].end; ++it)
+            {
+                if (it->sacked) continue;
+                on_delivered(*it, rtt_sent);
+                it->sacked = true;
+                sacked_bytes += it->end - it->seq;
+                if (it->lost)
+                {
+                    it->lost = false;
+                    lost_bytes -= it->end - it->seq;
+                }
+            }
+        }
+        // Karn: only never-retransmitted segments give an RTT sample
+        if (rtt_sent >= 0.0) rtt_sample(sim.now - rtt_sent);
+
+        bool new_ack = seg.ack > snd_una;
+        if (new_ack)
         {
             // New ACK
             total_acks_received++;
@@ -110,53 +218,62 @@ void Endpoint::on_segment(const Segment &seg)
 
             // Congestion control
             bool slow_start = cwnd < ssthresh;
-            if (cwnd < ssthresh) cwnd += mss;                // slow start
+            if (in_recovery)
+            {
+                // Partial ACKs keep us in recovery; the scoreboard drives the retransmits
+                if (snd_una >= recovery_point)
+                {
+                    in_recovery = false;
+                    cwnd = ssthresh;
+                }
+            } else if (cwnd < ssthresh) cwnd += mss;         // slow start
             else cwnd += (mss * mss) / max<uint32_t>(1, cwnd); // congestion avoidance
 
+            // A tail loss probe episode ends once everything up to the probe is ACKed.
+            // If the probe was a retransmission it repaired a loss: react like recovery would.
+            if (tlp_end_seq && snd_una >= tlp_end_seq)
+            {
+                if (tlp_retransmitted && !in_recovery)
+                {
+                    ssthresh = max<uint32_t>(mss * 2, cwnd / 2);
+                    cwnd = ssthresh;
+                }
+                tlp_end_seq = 0;
+            }
+
             // Track TCP state metrics
             TracyPlot("TCP_CWND", (int64_t) cwnd);
             TracyPlot("TCP_SSThresh", (int64_t) ssthresh);
-            TracyPlot("TCP_InFlight", (int64_t) (snd_nxt - snd_una));
+            TracyPlot("TCP_InFlight", (int64_t) pipe());
+            TracyPlot("TCP_SACKedBytes", (int64_t) sacked_bytes);
             TracyPlot("TCP_AppBytesSent", (int64_t) app_bytes_sent);
             TracyPlot("TCP_Retransmits", (int64_t) retransmits);
             TracyPlot("TCP_DupAcks", (int64_t) dupacks);
             TracyPlot("TCP_SlowStart", (int64_t) (slow_start ? 1 : 0));
             TracyPlot("TCP_TotalACKs", (int64_t) total_acks_received);
             TracyPlot("TCP_SegmentsSent", (int64_t) total_segments_sent);
-
-            cancel_timer();
-            if (snd_una < snd_nxt) arm_timer(); // still outstanding data
-            try_send_data();
-
-            // Was FIN acknowledged?
-            if (fin_sent && seg.ack == snd_nxt)
-            { fin_acked = true; }
-        } else if (seg.ack == snd_una && snd_una < snd_nxt)
+        } else if (seg.ack == snd_una && snd_una < snd_nxt &&
+                   (sacked_bytes > sacked_before || seg.wnd == old_rwnd))
         {
-            // Duplicate ACK
+            // Duplicate ACK (a pure window update is not one, RFC 5681)
             dupacks++;
             TracyPlot("TCP_DupAcks", (int64_t) dupacks);
+        } else if (seg.wnd == old_rwnd)
+        {
+            return; // nothing new
+        }
 
-            if (dupacks == 3)
-            {
-                // Fast retransmit / recovery
-                TracyMessageC("Fast Retransmit", 16, 0xFF0000);
-                ssthresh = max<uint32_t>(mss * 2, cwnd / 2);
-                cwnd = ssthresh + 3 * mss;
-                retransmits++;
-
-                TracyPlot("TCP_CWND", (int64_t) cwnd);
-                TracyPlot("TCP_SSThresh", (int64_t) ssthresh);
-                TracyPlot("TCP_Retransmits", (int64_t) retransmits);
-
-                send_segment(snd_una, mss, F_NONE); // retransmit oldest
-                arm_timer();
-            } else if (dupacks > 3)
-            {
-                cwnd += mss; // inflate
-                TracyPlot("TCP_CWND", (int64_t) cwnd);
-                try_send_data();
-            }
+        // RACK: anything sent sufficiently before a delivered segment is lost
+        if (rack_detect_loss() && !in_recovery) enter_recovery();
+        try_send_data();
+        rearm_timer(new_ack);
+
+        // Was FIN acknowledged?
+        if (fin_sent && seg.ack == snd_nxt && !fin_acked)
+        {
+            note_limit(limit); // close the last interval
+            fin_acked = true;
+            fin_acked_at = sim.now;
         }
     }
 }
@@ -169,29 +286,44 @@ void Endpoint::try_send_data()
     // Stop when all data + FIN sent
     while (true)
     {
-        uint32_t flight = snd_nxt - snd_una;
-        uint32_t allowed = (uint32_t) min<uint64_t>(cwnd, rwnd);
-        if (flight >= allowed) break;
+        uint32_t flight = pipe();
+        if (flight >= cwnd)
+        {
+            note_limit(L_CWND);
+            break;
+        }
 
-        if (app_bytes_sent < app_bytes_total)
+        if (TxSegment *lost = next_lost())
+        {
+            // Lost data takes priority over new data
+            retransmit(*lost);
+        } else if (app_bytes_sent < app_bytes_total)
         {
-            uint32_t can = min<uint32_t>(allowed - flight, mss);
+            // Flow control: new data must fit in the receiver's advertised window
+            uint32_t wnd_end = snd_una + rwnd;
+            if (snd_nxt >= wnd_end)
+            {
+                note_limit(L_RWND);
+                if (snd_una == snd_nxt && !persist_running) arm_persist(); // no ACK is coming
+                break;
+            }
+            persist_running = false;
+            persist_interval = 0.0;
+
+            uint32_t can = min({cwnd - flight, wnd_end - snd_nxt, mss});
             uint32_t remaining = (uint32_t) min<uint64_t>(mss, app_bytes_total - app_bytes_sent);
             auto len = (uint16_t) min<uint32_t>(can, remaining);
             if (len == 0) break;
-            send_segment(snd_nxt, len, F_NONE);
-            if (!timer_running) arm_timer();
-            snd_nxt += len;
+            send_new(len, F_NONE);
             app_bytes_sent += len;
         } else if (!fin_sent)
         {
             // Send FIN when all data queued
-            send_segment(snd_nxt, 0, F_FIN);
-            snd_nxt += 1;
+            send_new(0, F_FIN);
             fin_sent = true;
-            if (!timer_running) arm_timer();
         } else
         {
+            note_limit(L_NETWORK);
             break;
         }
     }
@@ -216,43 +348,392 @@ void Endpoint::send_segment(uint32_t seq, uint16_t len, Flags fl)
     conn->deliver(*this, dst, s);
 }
 
+void Endpoint::send_new(uint16_t len, Flags fl)
+{
+    send_segment(snd_nxt, len, fl);
+    TxSegment s;
+    s.seq = snd_nxt;
+    s.end = snd_nxt + len + (has(fl, F_FIN) ? 1 : 0);
+    s.sent = sim.now;
+    s.fin = has(fl, F_FIN);
+    rtx_queue.push_back(s);
+    snd_nxt = s.end;
+    if (!timer_running) rearm_timer(false);
+}
+
+void Endpoint::retransmit(TxSegment &s)
+{
+    // The FIN occupies the last sequence number; resend it as a flag, not a byte
+    send_segment(s.seq, (uint16_t) (s.end - s.seq - (s.fin ? 1 : 0)), s.fin ? F_FIN : F_NONE);
+    if (s.lost)
+    {
+        s.lost = false;
+        lost_bytes -= s.end - s.seq;
+    }
+    s.retransmitted = true;
+    s.sent = sim.now;
+    retransmits++;
+    TracyPlot("TCP_Retransmits", (int64_t) retransmits);
+    if (!timer_running) arm_timer();
+}
+
+TxSegment *Endpoint::next_lost()
+{
+    if (!lost_bytes) return nullptr;
+    for (auto &s : rtx_queue)
+        if (s.lost) return &s;
+    return nullptr;
+}
+
+uint32_t Endpoint::pipe() const
+{
+    // Outstanding minus what the receiver holds minus what we believe was lost
+    return snd_nxt - snd_una - sacked_bytes - lost_bytes;
+}
+
+void Endpoint::on_delivered(TxSegment &s, Time &rtt_sent)
+{
+    // A retransmission ACKed faster than any RTT seen was the original's ACK instead
+    Time rtt = sim.now - s.sent;
+    if (s.retransmitted && rtt < min_rtt) return;
+
+    if (s.sent > rack_xmit_ts || (s.sent == rack_xmit_ts && s.end > rack_end_seq))
+    {
+        rack_xmit_ts = s.sent;
+        rack_end_seq = s.end;
+        rack_rtt = rtt;
+    }
+    if (!s.retransmitted) rtt_sent = max(rtt_sent, s.sent);
+}
+
+void Endpoint::rtt_sample(Time r)
+{
+    if (srtt <= 0.0)
+    {
+        srtt = r;
+        rttvar = r / 2.0;
+    } else
+    {
+        rttvar = 0.75 * rttvar + 0.25 * abs(srtt - r);
+        srtt = 0.875 * srtt + 0.125 * r;
+    }
+    min_rtt = min_rtt > 0.0 ? min(min_rtt, r) : r;
+    // RFC 6298 (G = 1 ms); a fresh sample also clears any backoff
+    rto = clamp(srtt + max(0.001, 4.0 * rttvar), rto_min, rto_max);
+
+    TracyPlot("TCP_SRTT_ms", srtt * 1000.0);
+    TracyPlot("TCP_RTO", rto);
+}
+
+bool Endpoint::rack_detect_loss()
+{
+    rack_timeout = 0.0;
+    if (!rack_end_seq) return false;
+
+    // Allow a quarter RTT of reordering, none once recovery or dupthresh says loss
+    Time reo_wnd = (in_recovery || dupacks >= 3) ? 0.0 : min(min_rtt / 4.0, srtt);
+    bool marked = false;
+    for (auto &s : rtx_queue)
+    {
+        if (s.sacked || s.lost) continue;
+        // Only segments sent before the newest delivered one can be judged
+        if (s.sent > rack_xmit_ts || (s.sent == rack_xmit_ts && s.end >= rack_end_seq)) continue;
+
+        Time remaining = rack_rtt + reo_wnd - (sim.now - s.sent);
+        if (remaining <= 1e-6) // timers are no finer than a microsecond
+        {
+            s.lost = true;
+            lost_bytes += s.end - s.seq;
+            marked = true;
+        } else
+        {
+            rack_timeout = max(rack_timeout, remaining);
+        }
+    }
+    return marked;
+}
+
+void Endpoint::enter_recovery()
+{
+    // Fast retransmit / SACK recovery: only segments marked lost are resent
+    TracyMessageC("Fast Retransmit", 16, 0xFF0000);
+    ssthresh = max<uint32_t>(mss * 2, cwnd / 2);
+    cwnd = ssthresh;
+    in_recovery = true;
+    recovery_point = snd_nxt;
+    tlp_end_seq = 0; // this is the congestion response for any probe episode too
+
+    TracyPlot("TCP_CWND", (int64_t) cwnd);
+    TracyPlot("TCP_SSThresh", (int64_t) ssthresh);
+
+    if (TxSegment *lost = next_lost()) retransmit(*lost); // first hole goes out regardless
+}
+
+void Endpoint::send_ack()
+{
+    Segment ack;
+    ack.flags = F_ACK;
+    ack.seq = 5000;
+    ack.ack = rcv_nxt;
+    ack.len = 0;
+    ack.wnd = rcv_adv = rcv_wnd();
+    fill_sack(ack);
+    conn->deliver(*this, conn->A, ack);
+}
+
+uint32_t Endpoint::rcv_wnd() const
+{
+    uint32_t used = rcv_nxt - rcv_read;
+    uint32_t space = used < rcv_buf ? rcv_buf - used : 0;
+    // Receiver SWS avoidance (RFC 1122): don't offer slivers of window
+    return space < min(rcv_buf / 2, mss) ? 0 : space;
+}
+
+void Endpoint::start_reader()
+{
+    switch (reader.mode)
+    {
+        case R_INSTANT:
+            break; // reads as data arrives, see on_segment
+        case R_FIXED_RATE:
+        case R_BURSTY:
+            sim.at(sim.now + reader.period, [this]()
+            {
+                size_t budget = reader.mode == R_FIXED_RATE
+                                ? (size_t) (reader.rate_bps * reader.period / 8.0)
+                                : reader.burst_bytes;
+                on_app_read(budget);
+                if (!rcv_fin || rcv_read < rcv_fin) start_reader(); // until the FIN is read
+            });
+            break;
+        case R_SCRIPTED:
+            for (const auto &read : reader.script)
+                sim.at(read.first, [this, n = read.second]() { on_app_read(n); });
+            break;
+    }
+}
+
+size_t Endpoint::app_read(size_t max_bytes)
+{
+    // The FIN is consumed along with the last data byte
+    bool fin_in = rcv_fin && rcv_nxt >= rcv_fin;
+    uint32_t data_end = fin_in ? rcv_fin - 1 : rcv_nxt;
+    uint32_t avail = data_end > rcv_read ? data_end - rcv_read : 0;
+    auto n = (uint32_t) min<size_t>(max_bytes, avail);
+    rcv_read += n;
+    app_bytes_read += n;
+    if (fin_in && rcv_read == data_end) rcv_read = rcv_fin;
+    if (n) rcv_space_adjust();
+    return n;
+}
+
+void Endpoint::on_app_read(size_t max_bytes)
+{
+    if (!app_read(max_bytes)) return;
+    TracyPlot("TCP_AppBytesRead", (int64_t) app_bytes_read);
+    // Tell the sender once the window has opened meaningfully
+    if (rcv_wnd() >= rcv_adv + min(rcv_buf / 2, mss)) send_ack();
+}
+
+void Endpoint::rcv_space_adjust()
+{
+    if (!reader.autotune || rcv_rtt <= 0.0) return;
+    if (sim.now - rcv_space_time < rcv_rtt) return;
+
+    // Once per RTT: if the app read more than ever before, let the sender have twice that
+    uint32_t copied = rcv_read - rcv_space_seq;
+    if (copied > rcv_space)
+    {
+        rcv_space = copied;
+        rcv_buf = max(rcv_buf, (uint32_t) min<uint64_t>(reader.rcv_buf_max, 2ull * copied));
+        TracyPlot("TCP_RcvBuf", (int64_t) rcv_buf);
+    }
+    rcv_space_seq = rcv_read;
+    rcv_space_time = sim.now;
+}
+
+void Endpoint::note_limit(Limit why)
+{
+    if (fin_acked) return;
+    Time spent = sim.now - limit_since;
+    if (limit == L_CWND)
+    {
+        // While our backlog was still draining onto the link, the link was the bottleneck
+        Time busy = max(0.0, min(sim.now, limit_busy_until) - limit_since);
+        limited_s[L_NETWORK] += busy;
+        limited_s[L_CWND] += spent - busy;
+    } else
+    {
+        limited_s[limit] += spent;
+    }
+    limit = why;
+    limit_since = sim.now;
+    limit_busy_until = (this == &(conn->A)) ? conn->a_tx_free : conn->b_tx_free;
+    TracyPlot("TCP_LimitedBy", (int64_t) why);
+}
+
+void Endpoint::fill_sack(Segment &ack) const
+{
+    ack.sack_count = 0;
+    // The block holding the latest arrival goes first (RFC 2018), then the highest ones
+    const SeqRange *recent = ooo.find(last_ooo_seq);
+    if (recent) ack.sack[ack.sack_count++] = *recent;
+    for (auto it = ooo.ranges.rbegin(); it != ooo.ranges.rend() && ack.sack_count < MAX_SACK_BLOCKS; ++it)
+    {
+        if (&*it == recent) continue;
+        ack.sack[ack.sack_count++] = *it;
+    }
+}
+
 void Endpoint::arm_timer()
+{ set_timer(T_RTO, rto); }
+
+void Endpoint::set_timer(TimerMode mode, Time after)
 {
     timer_running = true;
-    timer_deadline = sim.now + rto;
+    timer_mode = mode;
+    timer_deadline = sim.now + after;
     sim.at(timer_deadline, [this]()
-    { if (timer_running && sim.now >= timer_deadline) on_timeout(); });
+    { if (timer_running && sim.now == timer_deadline) on_timer(); }); // stale events don't match
+}
+
+void Endpoint::rearm_timer(bool restart_rto)
+{
+    if (snd_una == snd_nxt)
+    {
+        cancel_timer();
+        return;
+    }
+    if (rack_timeout > 0.0)
+    {
+        set_timer(T_REORDER, rack_timeout);
+    } else if (established && !in_recovery && !tlp_end_seq)
+    {
+        // Probe the tail after two RTTs of silence rather than waiting out the RTO
+        Time pto = srtt > 0.0 ? 2.0 * srtt : 1.0;
+        set_timer(T_PTO, min(pto, rto));
+    } else if (restart_rto || !timer_running || timer_mode != T_RTO)
+    {
+        arm_timer();
+    }
 }
 
 void Endpoint::cancel_timer()
 { timer_running = false; }
 
+void Endpoint::on_timer()
+{
+    timer_running = false;
+    switch (timer_mode)
+    {
+        case T_RTO:
+            on_timeout();
+            break;
+        case T_PTO:
+            on_pto();
+            break;
+        case T_REORDER:
+            // The reordering window ran out for something still unacknowledged
+            if (rack_detect_loss() && !in_recovery) enter_recovery();
+            try_send_data();
+            rearm_timer(false);
+            break;
+    }
+}
+
+void Endpoint::on_pto()
+{
+    ZoneScoped;
+    TracyMessageC("Tail Loss Probe", 15, 0x00A0FF);
+    tail_loss_probes++;
+    TracyPlot("TCP_TailLossProbes", (int64_t) tail_loss_probes);
+
+    // Prefer new data if the receiver has room, regardless of cwnd; otherwise
+    // resend the highest unSACKed segment so its ACK or SACK reveals the tail
+    uint32_t remaining = (uint32_t) min<uint64_t>(mss, app_bytes_total - app_bytes_sent);
+    tlp_retransmitted = false;
+    if (remaining && snd_nxt + remaining <= snd_una + rwnd)
+    {
+        send_new((uint16_t) remaining, F_NONE);
+        app_bytes_sent += remaining;
+    } else
+    {
+        for (auto it = rtx_queue.rbegin(); it != rtx_queue.rend(); ++it)
+        {
+            if (it->sacked) continue;
+            retransmit(*it);
+            tlp_retransmitted = true;
+            break;
+        }
+    }
+    tlp_end_seq = snd_nxt;
+    arm_timer();
+}
+
+void Endpoint::arm_persist()
+{
+    persist_running = true;
+    persist_interval = persist_interval > 0.0 ? min(60.0, persist_interval * 2.0) : rto;
+    persist_deadline = sim.now + persist_interval;
+    sim.at(persist_deadline, [this]()
+    { if (persist_running && sim.now == persist_deadline) on_persist(); }); // stale events don't match
+}
+
+void Endpoint::on_persist()
+{
+    ZoneScoped;
+    TracyMessageC("Zero Window Probe", 17, 0xFFFF00);
+
+    // Window still shut and nothing in flight: resend an already-ACKed byte so the
+    // receiver answers with its current window
+    window_probes++;
+    TracyPlot("TCP_WindowProbes", (int64_t) window_probes);
+    send_segment(snd_una - 1, 1, F_NONE);
+    arm_persist();
+}
+
 void Endpoint::on_timeout()
 {
     ZoneScoped;
     TracyMessageC("RTO Timeout", 11, 0xFFA500);
 
+    if (!established)
+    {
+        // Lost SYN or SYN-ACK: try the handshake again
+        rto = min(rto_max, rto * 2.0);
+        syn_retransmitted = true;
+        send_segment(iss, 0, F_SYN);
+        arm_timer();
+        return;
+    }
+
     // Timeout: multiplicative decrease, reset to slow start
     ssthresh = max<uint32_t>(mss * 2, cwnd / 2);
     cwnd = mss;
-    rto = min(4.0, rto * 2.0); // simple backoff, cap at 4s
+    rto = min(rto_max, rto * 2.0); // exponential backoff until the next RTT sample
     dupacks = 0;
-    retransmits++;
+    in_recovery = false;
+    tlp_end_seq = 0;
+    rto_timeouts++;
 
     // Track timeout event metrics
     TracyPlot("TCP_CWND", (int64_t) cwnd);
     TracyPlot("TCP_SSThresh", (int64_t) ssthresh);
     TracyPlot("TCP_RTO", rto);
-    TracyPlot("TCP_Retransmits", (int64_t) retransmits);
 
-    // Retransmit the oldest unacked (up to MSS)
-    uint32_t outstanding = snd_nxt - snd_una;
-    auto len = (uint16_t) min<uint32_t>(mss, outstanding ? outstanding : mss);
-    send_segment(snd_una, len, F_NONE);
+    // Everything outstanding and not SACKed is now deemed lost; resend the holes
+    // from snd_una as slow start reopens cwnd, skipping what the receiver holds.
+    for (auto &s : rtx_queue)
+    {
+        if (s.sacked || s.lost) continue;
+        s.lost = true;
+        lost_bytes += s.end - s.seq;
+    }
+    try_send_data();
     arm_timer();
 }
 
-TCPConnection::TCPConnection(Link L, size_t app_bytes)
+TCPConnection::TCPConnection(Link L, size_t app_bytes, const RecvApp &reader, const SendConfig &sender)
         : A({"A", this}), B({"B", this}), link(L)
 {
     A.app_bytes_total = app_bytes;
@@ -262,14 +743,24 @@ TCPConnection::TCPConnection(Link L, size_t app_bytes)
     A.snd_nxt = A.iss;
     A.cwnd = A.mss;
     A.ssthresh = 65535;
+    A.rto_min = sender.rto_min;
+    A.rto_max = sender.rto_max;
     B.rcv_nxt = 5000; // ISN for B will be chosen on SYN
+    B.rcv_read = B.rcv_nxt;
+    B.reader = reader;
+    B.rcv_buf = reader.rcv_buf;
+    sim.at(0.0, [this]() { B.start_reader(); });
 }
 
 void TCPConnection::deliver(Endpoint &src, Endpoint &dst, Segment seg) const
 {
     ZoneScoped;
     seg.wire_size = seg.len + (size_t) header_bytes;
-    Time arrival = sim.now + link.xmit_delay(seg.wire_size) + link.prop_delay_s;
+    if (seg.sack_count) seg.wire_size += 2 + 8 * seg.sack_count; // SACK option
+    // Segments queue behind each other on the wire, so they arrive in order
+    Time &tx_free = (&src == &A) ? a_tx_free : b_tx_free;
+    tx_free = max(tx_free, sim.now) + link.xmit_delay(seg.wire_size);
+    Time arrival = tx_free + link.prop_delay_s;
     bool dropped = link.lost();
 
     total_packets_sent++;
@@ -7,6 +7,8 @@
 #include <random>
 #include <functional>
 #include <queue>
+#include <deque>
+#include <vector>
 
 using namespace std;
 
@@ -15,25 +17,27 @@ struct TCPConnection;
 
 // ============ Utilities ============
 using Time = double;
-static std::mt19937_64 rng(12345);
+inline std::mt19937_64 rng(12345);
 
 struct Event
 {
     Time t;
+    uint64_t order;             // insertion order, keeps same-time events FIFO
     function<void()> fn;
 
     bool operator<(const Event &o) const
-    { return t > o.t; } // min-heap via greater
+    { return t != o.t ? t > o.t : order > o.order; } // min-heap via greater
 };
 
-static struct Simulator
+inline struct Simulator
 {
     Time now = 0.0;
+    uint64_t next_order = 0;
     priority_queue<Event> pq;
 
     void at(Time t, function<void()> fn)
     {
-        pq.push(Event{t, std::move(fn)});
+        pq.push(Event{t, next_order++, std::move(fn)});
     }
 
     void run();
@@ -51,17 +55,94 @@ struct Link
     [[nodiscard]] bool lost() const;
 };
 
+// ============ Sequence ranges ============
+struct SeqRange
+{
+    uint32_t start = 0, end = 0; // [start, end)
+};
+
+// Out-of-order data the receiver holds above rcv_nxt, as sorted, disjoint,
+// coalesced ranges. A flat vector: a window only ever has a handful of holes.
+struct RangeSet
+{
+    vector<SeqRange> ranges;
+
+    void add(uint32_t start, uint32_t end);
+    void trim_below(uint32_t seq);        // forget everything before seq
+
+    [[nodiscard]] bool empty() const { return ranges.empty(); }
+    [[nodiscard]] const SeqRange* find(uint32_t seq) const;
+};
+
+// ============ Receiving application ============
+enum ReadMode : uint8_t
+{
+    R_INSTANT, R_FIXED_RATE, R_BURSTY, R_SCRIPTED
+};
+
+// How the application on B drains its socket, and how big that socket is.
+struct RecvApp
+{
+    ReadMode mode = R_INSTANT;          // R_INSTANT reads everything as it arrives
+    double rate_bps = 0;                // R_FIXED_RATE: drain speed
+    size_t burst_bytes = 0;             // R_BURSTY: bytes read per period
+    Time period = 0.010;                // R_FIXED_RATE / R_BURSTY: time between reads
+    vector<pair<Time, size_t>> script;  // R_SCRIPTED: (time, bytes) reads
+
+    uint32_t rcv_buf = 64 * 1024;       // initial receive buffer
+    uint32_t rcv_buf_max = 6 * 1024 * 1024;
+    bool autotune = true;               // grow the buffer to ~2x what the app reads per RTT
+};
+
+// What stopped the sender the last time it tried to send
+enum Limit : uint8_t
+{
+    L_NETWORK = 0, // link backlogged, or nothing left to send but ACKs to wait for
+    L_CWND = 1,    // congestion window full with the link idle
+    L_RWND = 2,    // receiver's advertised window full
+    L_COUNT = 3
+};
+
+// ============ Retransmission queue ============
+// One entry per segment sent and not yet cumulatively ACKed, in sequence order
+struct TxSegment
+{
+    uint32_t seq = 0, end = 0;    // [seq, end), a FIN counts as the last byte
+    Time sent = 0.0;              // last (re)transmission time
+    bool fin = false;
+    bool retransmitted = false;   // ACKs of it are ambiguous (Karn)
+    bool sacked = false;
+    bool lost = false;            // marked by RACK or RTO, awaiting retransmission
+};
+
+enum TimerMode : uint8_t
+{
+    T_RTO, T_PTO, T_REORDER
+};
+
+// Retransmission timer bounds for the sender on A
+struct SendConfig
+{
+    Time rto_min = 0.200;               // floor for the computed RTO (Linux default; RFC 6298 says 1 s)
+    Time rto_max = 4.0;                 // cap for the computed and backed-off RTO
+};
+
 // ============ TCP segment ============
 enum Flags : uint8_t
 {
     F_NONE = 0, F_SYN = 1, F_ACK = 2, F_FIN = 4
 };
 
+constexpr int MAX_SACK_BLOCKS = 3;
+
 struct Segment {
     uint32_t seq = 0;
     uint32_t ack = 0;
     Flags flags = F_NONE;
     uint16_t len = 0;
+    uint32_t wnd = 0;               // advertised receive window (bytes, already scaled)
+    uint8_t sack_count = 0;
+    SeqRange sack[MAX_SACK_BLOCKS]; // SACK option (RFC 2018), first = most recent
     size_t wire_size = 0;
 };
 
@@ -71,21 +152,68 @@ struct Endpoint {
     TCPConnection* conn = nullptr;
     // Receiver state
     uint32_t rcv_nxt = 0;
+    RangeSet ooo;                 // out-of-order data held above rcv_nxt
+    uint32_t last_ooo_seq = 0;    // most recent out-of-order arrival, reported first
+    RecvApp reader;
+    uint32_t rcv_buf = 0;         // receive buffer size, grows with autotuning
+    uint32_t rcv_read = 0;        // next sequence the application will read
+    uint32_t rcv_fin = 0;         // sequence just past FIN, once received
+    uint32_t rcv_adv = 0;         // window advertised in the last ACK
+    size_t app_bytes_read = 0;
+
+    // Receive buffer autotuning (Linux DRS-style)
+    Time rcv_rtt = 0.0;           // time to receive one window, an upper bound on RTT
+    uint32_t rcv_rtt_seq = 0;
+    Time rcv_rtt_time = 0.0;
+    uint32_t rcv_space = 0;       // most the app read in one rcv_rtt so far
+    uint32_t rcv_space_seq = 0;
+    Time rcv_space_time = 0.0;
 
     // Sender state
     uint32_t iss = 0, snd_una = 0, snd_nxt = 0;
     uint32_t cwnd = 0, ssthresh = 0;
     uint32_t dupacks = 0;
     uint32_t mss = 1000;          // bytes
-    uint32_t rwnd = 1<<30;        // infinite for simplicity
+    uint32_t rwnd = 0;            // peer's advertised window
     bool established = false;
     bool fin_sent = false, fin_acked = false;
 
-    // RTO management (single outstanding timer)
-    Time rto = 1.0;               // seconds (fixed; you can add RTT estimator)
+    // Retransmission queue doubling as the SACK scoreboard
+    deque<TxSegment> rtx_queue;
+    uint32_t sacked_bytes = 0;    // queued bytes the receiver holds
+    uint32_t lost_bytes = 0;      // queued bytes marked lost and not yet resent
+    bool in_recovery = false;
+    uint32_t recovery_point = 0;  // snd_nxt when recovery began
+
+    // RACK (RFC 8985): the most recently sent segment known to be delivered
+    Time rack_xmit_ts = 0.0;
+    uint32_t rack_end_seq = 0;
+    Time rack_rtt = 0.0;
+    Time rack_timeout = 0.0;      // reorder window still pending, 0 if none
+
+    // Tail loss probe
+    uint32_t tlp_end_seq = 0;     // snd_nxt when the probe went out, 0 if none
+    bool tlp_retransmitted = false;
+
+    // RTT estimation (RFC 6298) and RTO management
+    Time srtt = 0.0, rttvar = 0.0;
+    Time min_rtt = 0.0;
+    Time rto = 1.0;               // seconds, until the first RTT sample
+    Time rto_min = 0.200;         // from SendConfig
+    Time rto_max = 4.0;
+    Time syn_sent_at = 0.0;
+    bool syn_retransmitted = false;
+
+    // Single timer shared by RTO, tail loss probe and RACK reordering
     bool timer_running = false;
+    TimerMode timer_mode = T_RTO;
     Time timer_deadline = 0.0;
 
+    // Persist timer, probes a zero window while nothing is outstanding
+    bool persist_running = false;
+    Time persist_interval = 0.0;
+    Time persist_deadline = 0.0;
+
     // App data to send (only on A)
     size_t app_bytes_total = 0;
     size_t app_bytes_sent = 0;
@@ -94,15 +222,47 @@ struct Endpoint {
     size_t retransmits = 0;
     size_t total_segments_sent = 0;
     size_t total_acks_received = 0;
+    size_t window_probes = 0;
+    size_t tail_loss_probes = 0;
+    size_t rto_timeouts = 0;
+    Time fin_acked_at = 0.0;
+
+    // Time spent limited by each of Limit, closed when the FIN is ACKed
+    Time limited_s[L_COUNT] = {};
+    Limit limit = L_NETWORK;
+    Time limit_since = 0.0;
+    Time limit_busy_until = 0.0;  // link backlog when an L_CWND interval began
 
     // API
     void start_client();        // A starts with SYN
     void on_segment(const Segment& seg);
     void try_send_data();
     void send_segment(uint32_t seq, uint16_t len, Flags fl);
+    void send_new(uint16_t len, Flags fl);
+    void retransmit(TxSegment &s);
+    [[nodiscard]] TxSegment *next_lost();
+    [[nodiscard]] uint32_t pipe() const;
+    void on_delivered(TxSegment &s, Time &rtt_sent);
+    void rtt_sample(Time r);
+    bool rack_detect_loss();
+    void enter_recovery();
+    void fill_sack(Segment &ack) const;
+    void send_ack();
+    [[nodiscard]] uint32_t rcv_wnd() const;
+    void start_reader();
+    size_t app_read(size_t max_bytes);
+    void on_app_read(size_t max_bytes);
+    void rcv_space_adjust();
+    void note_limit(Limit why);
+    void arm_persist();
+    void on_persist();
     void arm_timer();
+    void set_timer(TimerMode mode, Time after);
+    void rearm_timer(bool restart_rto);
     void cancel_timer();
+    void on_timer();
     void on_timeout();
+    void on_pto();
 };
 
 struct TCPConnection {
@@ -111,7 +271,8 @@ struct TCPConnection {
     Time header_bytes = 40;
     mutable size_t total_packets_dropped = 0;
     mutable size_t total_packets_sent = 0;
-    TCPConnection(Link L, size_t app_bytes);
+    mutable Time a_tx_free = 0.0, b_tx_free = 0.0; // per-direction serialization
+    TCPConnection(Link L, size_t app_bytes, const RecvApp &reader = {}, const SendConfig &sender = {});
     void deliver(Endpoint& src, Endpoint& dst, Segment seg) const;
 };
 